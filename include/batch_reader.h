@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+Bulk file ingestion. Reads for many files are kept in flight at once, through io_uring into
+registered buffers where the kernel allows it and through a pool of pread threads otherwise.
+Each file is handed to the consumer on the calling thread as soon as its read completes, so
+parsing one file overlaps with the I/O of the others.
+
+Files can complete in any order. The contents view is only valid during the consumer call.
+*/
+
+using File_consumer = std::function<void(const std::string & path, std::string_view contents)>;
+
+class Batch_reader {
+public:
+	// at most queue_depth files are read ahead of the consumer
+	explicit Batch_reader(unsigned queue_depth = 64) : queue_depth_(queue_depth == 0 ? 1 : queue_depth) {}
+
+	// false if any file could not be read, the rest are still consumed
+	bool read(const std::vector<std::string> & paths, const File_consumer & consumer);
+
+	// how the last read() was served
+	const char * backend() const { return backend_; }
+
+private:
+	unsigned queue_depth_;
+	const char * backend_ = "none";
+};
+
+// the plain blocking std::ifstream path, one file after another, to compare against
+bool read_sequentially(const std::vector<std::string> & paths, const File_consumer & consumer);
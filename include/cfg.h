@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "token.h"
+
+/*
+Control-flow graph of a function, built straight from its tokens.
+
+Declarations (and the arguments, at entry) are the definitions of a variable, identifiers read
+in expressions are its uses. Straight-line statements share a basic block; for, loop and agar
+open new blocks for their condition, body and continuation. Variables are interned per function
+by name, nested blocks do not introduce new scopes.
+
+Inside a condition header (for < ... >, loop < ... >, agar < ... >) a '<' in operand position
+opens a group and a '>' closes the innermost open group, or the header when none is open.
+*/
+
+struct Cfg_instruction {
+	enum class Kind {
+		DECLARE,
+		USE
+	};
+
+	Kind kind{};
+	uint32_t variable = 0;
+	size_t offset = 0; // byte offset of the identifier
+};
+
+struct Basic_block {
+	std::vector<Cfg_instruction> instructions;
+	std::vector<uint32_t> successors;
+	std::vector<uint32_t> predecessors;
+};
+
+struct Control_flow_graph {
+	static constexpr uint32_t entry = 0;
+	static constexpr uint32_t exit = 1;
+
+	std::string name; // of the function
+	std::vector<Basic_block> blocks;
+	std::vector<std::string> variables; // interned names, indexed by variable id
+
+	// block ids in reverse post-order from the entry
+	std::vector<uint32_t> reverse_post_order() const;
+};
+
+// one graph per function of the END_OF_FILE terminated tokens, nullopt on a syntax error
+std::optional<std::vector<Control_flow_graph>> build_cfgs(const std::vector<Token> & tokens);
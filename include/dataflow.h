@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "cfg.h"
+
+/*
+Declaration lints over a Control_flow_graph, answered per variable. A variable's live range is
+found by walking backwards from the blocks that read it before declaring it, stopping at its
+declarations; whether the undeclared state from entry or some declaration reaches those reads
+is then propagated forwards inside that range only. Variables go through this 64 at a time, one
+bit each in a word per block, and the words are reused for every batch: memory is linear in the
+graph, time is the summed size of the live ranges over 64.
+*/
+
+struct Lint_warning {
+	enum class Kind {
+		UNDECLARED, // used with no declaration reaching it
+		MAYBE_UNDECLARED, // not declared on every path to the use
+		UNUSED // declared, then never read
+	};
+
+	Kind kind{};
+	uint32_t variable = 0;
+	size_t offset = 0;
+};
+
+// warnings sorted by offset, unreachable blocks are left out
+std::vector<Lint_warning> lint(const Control_flow_graph & cfg);
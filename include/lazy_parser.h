@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.h"
+
+/*
+Lazy parsing: only function signatures (Type identifier < ArgList >) are parsed up front.
+Each body is recorded as the byte range of its CompoundStmt, found by brace matching on the raw
+bytes (braces cannot occur inside any other token), and is parsed the first time it is asked for.
+Different bodies may be materialized concurrently; each one is parsed exactly once.
+
+A lazily read file may hold a sequence of functions rather than the single one the eager
+parser accepts.
+*/
+
+// offset one past the '}' matching the '{' at open, or npos if the braces are unbalanced
+size_t skip_braces(std::string_view input, size_t open);
+
+struct Parsed_body {
+	bool valid = false;
+	std::vector<Token> tokens; // matched tokens of the CompoundStmt, braces included
+};
+
+class Lazy_body {
+public:
+	struct Range {
+		std::string_view input;
+		size_t begin = 0; // offset of '{'
+		size_t end = 0; // offset one past '}'
+	};
+
+	Lazy_body(const Range range, const Parser & parser, const Line_index & lines) : range_(range), parser_(parser), lines_(lines) {}
+
+	size_t begin() const { return range_.begin; }
+	size_t end() const { return range_.end; }
+	bool parsed() const { return parsed_; }
+
+	// parses the body on first access, safe to call from several threads
+	const Parsed_body & get();
+
+private:
+	Range range_;
+	const Parser & parser_;
+	const Line_index & lines_;
+
+	std::once_flag once_;
+	std::atomic<bool> parsed_ = false;
+	Parsed_body result_;
+};
+
+struct Lazy_function {
+	Lazy_function(std::vector<Token> signature, Lazy_body::Range body_range, const Parser & parser, const Line_index & lines)
+		: signature(std::move(signature)), body(body_range, parser, lines) {}
+
+	std::vector<Token> signature; // Type identifier < ArgList >
+	Lazy_body body;
+};
+
+class Lazy_program {
+public:
+	// the program only views the input, which has to outlive it
+	explicit Lazy_program(std::string_view input);
+	Lazy_program(std::string && input) = delete;
+
+	Lazy_program(const Lazy_program &) = delete;
+	Lazy_program & operator = (const Lazy_program &) = delete;
+
+	// false if a signature failed to parse or a body is unterminated
+	bool valid() const { return valid_; }
+
+	std::deque<Lazy_function> & functions() { return functions_; }
+	const std::deque<Lazy_function> & functions() const { return functions_; }
+
+private:
+	std::string_view input_;
+	Line_index lines_;
+	Parser parser_;
+	std::deque<Lazy_function> functions_;
+	bool valid_ = false;
+};
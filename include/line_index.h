@@ -0,0 +1,35 @@
+#pragma once
+
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 1-based, the column counts bytes
+struct Source_position {
+	size_t line = 1;
+	size_t column = 1;
+};
+
+std::ostream & operator << (std::ostream & os, const Source_position & position);
+
+/*
+Maps token byte offsets to line and column. The newline table is built in one vectorized pass
+the first time a position is asked for, so inputs that never need a diagnostic pay nothing;
+lookups are a binary search over it. Safe to query from several threads.
+*/
+class Line_index {
+public:
+	// the index only views the input, which has to outlive it
+	explicit Line_index(std::string_view input) : input_(input) {}
+	Line_index(std::string && input) = delete;
+
+	Source_position position(size_t offset) const;
+
+private:
+	std::string_view input_;
+
+	mutable std::once_flag built_;
+	mutable std::vector<size_t> line_starts_; // offset of the first byte of every line
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "token.h"
+
+/*
+Speculative parallel lexing of a single buffer.
+
+The input is cut into one chunk per thread. Each chunk starts at the first whitespace
+after its nominal split point, since no token can contain whitespace, and is lexed
+independently. The per-chunk token arrays are then stitched in order: a chunk whose
+start guess landed inside a token of its predecessor is re-lexed from the correct
+position until its tokens line up with the speculative ones again.
+
+The returned tokens (including the trailing END_OF_FILE) are identical to what repeated
+Scanner::nextToken calls produce for the same input.
+*/
+
+std::vector<Token> lex_parallel(std::string_view input, size_t thread_count = 0);
+
+// replays a token array through the same interface as Scanner
+class Token_buffer {
+public:
+	explicit Token_buffer(std::vector<Token> tokens) : tokens_(std::move(tokens)) {}
+
+	Token nextToken() {
+		// keeps returning the last token (END_OF_FILE) once exhausted, like the scanner does
+		return position_ + 1 < tokens_.size() ? tokens_[position_++] : tokens_.back();
+	}
+
+private:
+	std::vector<Token> tokens_;
+	size_t position_ = 0;
+};
@@ -5,8 +5,11 @@
 #include <string>
 #include <stack>
 #include <variant>
+#include <string_view>
+#include <sstream>
 
 #include "scanner.h"
+#include "line_index.h"
 
 enum Non_terminal {
     ARG,
@@ -205,6 +208,79 @@ Term	< identifier number				!= * + / ; < <= <> == > >= –
 Type	float int					identifier
 */
 
+/*
+Parse events. Parser::parse is templated on the handler, so every callback is resolved at
+compile time; a handler derives from Parse_handler and hides only the callbacks it cares about,
+the rest are empty and vanish. on_exit needs extra bookkeeping on the parse stack, which is only
+done for handlers that set wants_exit.
+*/
+
+struct Parse_handler {
+	static constexpr bool wants_exit = false;
+	// hand the first CompoundStmt to on_body and stop there instead of parsing it
+	static constexpr bool stops_at_body = false;
+
+	void on_enter(Non_terminal, std::string_view /* production */) {}
+	void on_exit(Non_terminal) {}
+	void on_token(Terminal, const Token &) {}
+	// a terminal that did not match, parsing stops
+	void on_mismatch(Terminal /* expected */, const Token &) {}
+	// no production for the lookahead, parsing stops unless the token is in the follow set
+	void on_no_production(Non_terminal, const Token &, bool /* recovered */) {}
+	void on_body(const Token & /* lbrace */) {}
+};
+
+// reports parse errors only
+struct Error_printer : Parse_handler {
+	// when set, messages are prefixed with the line:column of the offending token
+	const Line_index * lines = nullptr;
+
+	void on_mismatch(const Terminal expected, const Token & token) {
+		std::cerr << "[Error] " << location(token) << "Expected " << to_string(expected) << " but got " << token.value << "\n";
+	}
+
+	void on_no_production(const Non_terminal non_terminal, const Token & token, const bool recovered) {
+		std::cout << "[Warning] " << location(token) << "No production found for " << to_string(non_terminal) << " and " << token.value << '\n';
+
+		if(recovered) {
+			std::cout << "[Panic mode]: using sync\n";
+		}
+	}
+
+	std::string location(const Token & token) const {
+
+		if(!lines) {
+			return "";
+		}
+
+		std::ostringstream os;
+		os << lines->position(token.offset) << ": ";
+		return os.str();
+	}
+};
+
+// the classic [INFO] trace of the parse
+struct Info_printer : Error_printer {
+
+	void on_enter(Non_terminal, const std::string_view production) {
+		std::cout << "[INFO] Using production rule \"" << production << "\"\n";
+	}
+
+	void on_token(const Terminal terminal, const Token & token) {
+
+		if(token.type == TokenType::IDENTIFIER) {
+			std::cout << "[INFO] Matched identifier '" << token.value << "'\n";
+		} else {
+			std::cout << "[INFO] Matched " << to_string(terminal) << "\n";
+		}
+	}
+
+	void on_no_production(const Non_terminal non_terminal, const Token & token, const bool recovered) {
+		std::cout << "[INFO] Using production rule \"\"\n";
+		Error_printer::on_no_production(non_terminal, token, recovered);
+	}
+};
+
 class Parser {
 public:
 
@@ -390,51 +466,75 @@ public:
 		follow_[TYPE][T_IDENTIFIER] = true;
 	}
 
-	void parse(Scanner & scanner) {
-		std::stack<std::variant<Terminal, Non_terminal>> stack;
+	// works on anything with a Scanner-like nextToken(), e.g. a Token_buffer
+	template<typename Token_source>
+	bool parse(Token_source & scanner) const {
+		Info_printer printer;
+		return parse(scanner, printer);
+	}
+
+	// the tables are only read here, so one parser can serve several threads
+	template<typename Token_source, typename Handler>
+	bool parse(Token_source & scanner, Handler & handler, const Non_terminal start = FUNCTION) const {
+		std::stack<std::variant<Terminal, Non_terminal, Exit>> stack;
 
 		stack.push(T_END);
-		stack.push(FUNCTION);
+		stack.push(start);
 
 		auto token = scanner.nextToken();
 
-		while(std::holds_alternative<Non_terminal>(stack.top()) || std::get<Terminal>(stack.top()) != T_END) {
+		while(!std::holds_alternative<Terminal>(stack.top()) || std::get<Terminal>(stack.top()) != T_END) {
 			const auto top = stack.top();
 			stack.pop();
 
+			if constexpr(Handler::wants_exit) {
+
+				if(std::holds_alternative<Exit>(top)) {
+					handler.on_exit(std::get<Exit>(top).non_terminal);
+					continue;
+				}
+			}
+
 			if(std::holds_alternative<Terminal>(top)) {
 				const auto terminal = std::get<Terminal>(top);
 
 				if(token.type == TokenType::IDENTIFIER || to_string(terminal) == token.value) {
-
-					if(token.type == TokenType::IDENTIFIER) {
-						std::cout << "[INFO] Matched identifier '" << token.value << "'\n";
-					} else {
-						std::cout << "[INFO] Matched " << to_string(terminal) << "\n";
-					}
-
+					handler.on_token(terminal, token);
 					token = scanner.nextToken();
 					continue;
 				}
 
-				std::cerr << "[Error] Expected " << to_string(terminal) << " but got " << token.value << "\n";
-				return;
+				handler.on_mismatch(terminal, token);
+				return false;
 			}
 
 			const auto non_terminal = std::get<Non_terminal>(top);
 
-			auto production = parse_table_[non_terminal][to_terminal(token)];
-			std::cout << "[INFO] Using production rule \"" << production << "\"\n";
+			const auto & production = lookup(parse_table_, non_terminal, to_terminal(token));
 
 			if(production.empty()) {
-				std::cout << "[Warning] No production found for " << to_string(non_terminal) << " and " << token.value << '\n';
+				const bool recovered = lookup(follow_, non_terminal, to_terminal(token));
+				handler.on_no_production(non_terminal, token, recovered);
 
-				if(follow_[non_terminal][to_terminal(token)]) {
-					std::cout << "[Panic mode]: using sync\n";
+				if(recovered) {
 					continue;
 				}
 
-				return;
+				return false;
+			}
+
+			if constexpr(Handler::stops_at_body) {
+
+				if(non_terminal == COMPOUND_STMT) {
+					handler.on_body(token);
+					return true;
+				}
+			}
+
+			handler.on_enter(non_terminal, production);
+
+			if constexpr(Handler::wants_exit) {
+				stack.push(Exit{non_terminal});
 			}
 
 			std::vector<std::string> symbols;
@@ -493,10 +593,32 @@ public:
 				}
 			}
 		}
+
+		return true;
 	}
 
 private:
 
+	// marks where a non-terminal's expansion ends on the parse stack
+	struct Exit {
+		Non_terminal non_terminal;
+	};
+
+	// missing entries read as empty/false without inserting into the table
+	template<typename Value>
+	static const Value & lookup(const std::map<Non_terminal, std::map<Terminal, Value>> & table, const Non_terminal non_terminal, const Terminal terminal) {
+		static const Value empty{};
+
+		const auto row = table.find(non_terminal);
+
+		if(row == table.end()) {
+			return empty;
+		}
+
+		const auto entry = row->second.find(terminal);
+		return entry == row->second.end() ? empty : entry->second;
+	}
+
 	void setup() {
 		parse_table_[FUNCTION][T_INT] = "Type identifier < ArgList > CompoundStmt";
 		parse_table_[FUNCTION][T_FLOAT] = "Type identifier < ArgList > CompoundStmt";
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+/*
+Hardware performance counters for the calling thread through perf_event_open. The events are
+opened as one group led by cycles, so they are scheduled together and ratios between them
+(IPC, misses per token) come from the same stretch of execution. An event the group rejects,
+or every event when cycles itself is missing, is opened on its own instead, so a PMU that lacks
+some of them still reports the rest; counts are scaled when the kernel had to multiplex them.
+Without counters at all (no PMU, as in most containers and VMs, or a restrictive
+perf_event_paranoid) only the wall-clock time is measured and the code being measured runs the
+same either way.
+*/
+
+class Perf_counters {
+public:
+	enum Event {
+		CYCLES,
+		INSTRUCTIONS,
+		BRANCH_MISSES,
+		L1D_MISSES,
+		LLC_MISSES,
+		EVENT_COUNT
+	};
+
+	struct Sample {
+		std::array<double, EVENT_COUNT> values{};
+		std::array<bool, EVENT_COUNT> valid{};
+		double seconds = 0;
+	};
+
+	Perf_counters();
+	~Perf_counters();
+
+	Perf_counters(const Perf_counters &) = delete;
+	Perf_counters & operator = (const Perf_counters &) = delete;
+
+	// true if at least one counter could be opened
+	bool available() const;
+	// why the first counter that failed could not be opened
+	const std::string & error() const { return error_; }
+
+	void start();
+	Sample stop();
+
+	static const char * name(Event event);
+
+private:
+	std::array<int, EVENT_COUNT> fds_;
+	std::array<bool, EVENT_COUNT> grouped_{}; // read through the cycles leader rather than its own fd
+	std::string error_;
+	std::chrono::steady_clock::time_point start_;
+};
+
+// one line per phase: time, IPC and misses per token, for the counters that were available
+void report(std::ostream & os, std::string_view phase, const Perf_counters::Sample & sample, size_t tokens);
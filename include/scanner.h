@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <cctype>
 #include <unordered_map>
 
@@ -9,16 +10,23 @@
 class Scanner {
 
 public:
-	Scanner(const std::string & input) : input_(input), current_char_(input[0]) {}
+	// the scanner only views the input, which has to outlive it
+	Scanner(std::string_view input, const size_t position = 0, const bool report_errors = true)
+		: input_(input), position_(position), current_char_(position < input.size() ? input[position] : '\0'), report_errors_(report_errors) {}
+	Scanner(std::string && input, size_t position = 0, bool report_errors = true) = delete;
+
 	Token nextToken();
+	size_t position() const { return position_; }
 
 private:
-	std::string input_;
+	std::string_view input_;
 	size_t position_ = 0;
 	char current_char_ = 0;
+	bool report_errors_ = true;
 
 	void advance();
 	void skip_whitespace();
+	Token scan_token();
 	Token identifier_or_keyword();
 	Token number();
 	Token single_char_token(TokenType type);
@@ -84,6 +84,7 @@ inline std::ostream & operator << (std::ostream & os, const TokenType type) {
 struct Token {
 	TokenType type{};
 	std::string value;
+	size_t offset = 0; // byte offset of the first character in the input
 
 	Token() = default;
 	Token(const TokenType type, std::string value = "") : type(type), value(std::move(value)) {}
@@ -91,4 +92,12 @@ struct Token {
 	std::ostream & operator << (std::ostream & os) const {
 		return os << type << ' ' << value;
 	}
+
+	bool operator == (const Token & other) const {
+		return type == other.type && value == other.value && offset == other.offset;
+	}
+
+	bool operator != (const Token & other) const {
+		return !(*this == other);
+	}
 };
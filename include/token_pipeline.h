@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "token.h"
+
+// lock-free single-producer/single-consumer ring, slots are filled and drained in place
+template<typename T>
+class Spsc_ring {
+public:
+	explicit Spsc_ring(const size_t capacity) : slots_(round_up(capacity)), mask_(slots_.size() - 1) {}
+
+	// producer: the next free slot, or nullptr while the ring is full
+	T * claim() {
+		const auto tail = tail_.load(std::memory_order_relaxed);
+
+		if(tail - head_cache_ == slots_.size()) {
+			head_cache_ = head_.load(std::memory_order_acquire);
+
+			if(tail - head_cache_ == slots_.size()) {
+				return nullptr;
+			}
+		}
+
+		return &slots_[tail & mask_];
+	}
+
+	// producer: hands the claimed slot over
+	void publish() {
+		tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// consumer: the oldest published slot, or nullptr while the ring is empty
+	T * front() {
+		const auto head = head_.load(std::memory_order_relaxed);
+
+		if(head == tail_cache_) {
+			tail_cache_ = tail_.load(std::memory_order_acquire);
+
+			if(head == tail_cache_) {
+				return nullptr;
+			}
+		}
+
+		return &slots_[head & mask_];
+	}
+
+	// consumer: gives the front slot back to the producer
+	void pop() {
+		head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+private:
+	static size_t round_up(const size_t capacity) {
+		size_t size = 1;
+
+		while(size < capacity) {
+			size *= 2;
+		}
+
+		return size;
+	}
+
+	std::vector<T> slots_;
+	const size_t mask_;
+
+	// each side's index and its cached copy of the other side's index share a cache line
+	alignas(64) std::atomic<size_t> head_{0};
+	size_t tail_cache_ = 0;
+
+	alignas(64) std::atomic<size_t> tail_{0};
+	size_t head_cache_ = 0;
+};
+
+/*
+Runs a Scanner on a producer thread and hands its tokens to the consumer in batches through an
+Spsc_ring, so lexing and parsing overlap. The producer waits while the ring is full; destroying
+the pipeline (e.g. after a parse error) stops it promptly, wherever it is.
+*/
+class Token_pipeline {
+public:
+	// the pipeline only views the input, which has to outlive it
+	explicit Token_pipeline(std::string_view input, size_t batch_size = 512, size_t batch_count = 64);
+	Token_pipeline(std::string && input, size_t batch_size = 512, size_t batch_count = 64) = delete;
+	~Token_pipeline();
+
+	Token_pipeline(const Token_pipeline &) = delete;
+	Token_pipeline & operator = (const Token_pipeline &) = delete;
+
+	// same stream as Scanner::nextToken, END_OF_FILE repeats once reached
+	Token nextToken();
+
+private:
+	void produce(std::string_view input);
+
+	Spsc_ring<std::vector<Token>> ring_;
+	const size_t batch_size_;
+	std::atomic<bool> stopping_{false};
+
+	std::vector<Token> * batch_ = nullptr; // consumer's current slot
+	size_t position_ = 0;
+	bool finished_ = false;
+	Token end_of_file_;
+
+	std::thread producer_; // last, starts once everything above is ready
+};
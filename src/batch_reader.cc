@@ -0,0 +1,558 @@
+#include "batch_reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace {
+
+// files up to this size are read into a registered buffer, larger ones into their own allocation
+constexpr size_t slot_size = 1 << 18;
+
+struct Open_file {
+	int fd = -1;
+	size_t size = 0;
+};
+
+bool open_file(const std::string & path, Open_file & file) {
+	file.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if(file.fd < 0) {
+		std::cerr << "Error: Could not open file " << path << "\n";
+		return false;
+	}
+
+	struct stat status{};
+
+	if(::fstat(file.fd, &status) != 0 || !S_ISREG(status.st_mode)) {
+		std::cerr << "Error: Could not open file " << path << "\n";
+		::close(file.fd);
+		file.fd = -1;
+		return false;
+	}
+
+	file.size = static_cast<size_t>(status.st_size);
+	return true;
+}
+
+#ifdef HAVE_IO_URING
+
+// the bare minimum of liburing, on top of the raw system calls
+class Ring {
+public:
+	Ring() = default;
+	Ring(const Ring &) = delete;
+	Ring & operator = (const Ring &) = delete;
+
+	~Ring() {
+		if(sqes_) ::munmap(sqes_, sqes_size_);
+		if(cq_ring_ && cq_ring_ != sq_ring_) ::munmap(cq_ring_, cq_ring_size_);
+		if(sq_ring_) ::munmap(sq_ring_, sq_ring_size_);
+		if(fd_ >= 0) ::close(fd_);
+	}
+
+	// false if the kernel has no io_uring or it is filtered out, as in some containers
+	bool setup(const unsigned entries) {
+		io_uring_params params{};
+		fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+
+		if(fd_ < 0) {
+			return false;
+		}
+
+		entries_ = params.sq_entries;
+		sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+		if(params.features & IORING_FEAT_SINGLE_MMAP) {
+			sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+		}
+
+		sq_ring_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+
+		if(!sq_ring_) {
+			return false;
+		}
+
+		cq_ring_ = params.features & IORING_FEAT_SINGLE_MMAP ? sq_ring_ : map(cq_ring_size_, IORING_OFF_CQ_RING);
+		sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+		sqes_ = static_cast<io_uring_sqe *>(map(sqes_size_, IORING_OFF_SQES));
+
+		if(!cq_ring_ || !sqes_) {
+			return false;
+		}
+
+		auto * const sq = static_cast<char *>(sq_ring_);
+		sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+		sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+		sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+		sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+		auto * const cq = static_cast<char *>(cq_ring_);
+		cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+		cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+		cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+		cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+		sq_local_tail_ = *sq_tail_;
+		return true;
+	}
+
+	// IORING_REGISTER_PROBE came in the same kernel (5.6) as IORING_OP_READ, so a ring that rejects the probe lacks the opcode as well
+	bool supports(const uint8_t opcode) const {
+		constexpr unsigned op_count = 256;
+		std::vector<uint64_t> storage((sizeof(io_uring_probe) + op_count * sizeof(io_uring_probe_op) + 7) / 8);
+		auto * const probe = reinterpret_cast<io_uring_probe *>(storage.data());
+
+		if(::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, op_count) != 0) {
+			return false;
+		}
+
+		return opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+	}
+
+	bool register_buffers(const iovec * buffers, const unsigned count) {
+		return ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+	}
+
+	// the caller never has more than entries() requests outstanding, so this cannot overflow
+	io_uring_sqe & next_sqe() {
+		const auto index = sq_local_tail_++ & sq_mask_;
+		sq_array_[index] = index;
+
+		auto & sqe = sqes_[index];
+		std::memset(&sqe, 0, sizeof(sqe));
+		return sqe;
+	}
+
+	// submits everything queued by next_sqe without waiting for any of it
+	bool submit() { return enter(0); }
+
+	// submits everything queued by next_sqe and waits for at least one completion
+	bool submit_and_wait() { return enter(1); }
+
+	bool pop_completion(io_uring_cqe & cqe) {
+		const auto head = *cq_head_;
+
+		if(head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+			return false;
+		}
+
+		cqe = cqes_[head & cq_mask_];
+		__atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	unsigned entries() const { return entries_; }
+
+private:
+	int fd_ = -1;
+	unsigned entries_ = 0;
+
+	void * sq_ring_ = nullptr;
+	void * cq_ring_ = nullptr;
+	io_uring_sqe * sqes_ = nullptr;
+	size_t sq_ring_size_ = 0;
+	size_t cq_ring_size_ = 0;
+	size_t sqes_size_ = 0;
+
+	unsigned * sq_head_ = nullptr;
+	unsigned * sq_tail_ = nullptr;
+	unsigned * sq_array_ = nullptr;
+	unsigned sq_mask_ = 0;
+	unsigned sq_local_tail_ = 0;
+
+	unsigned * cq_head_ = nullptr;
+	unsigned * cq_tail_ = nullptr;
+	io_uring_cqe * cqes_ = nullptr;
+	unsigned cq_mask_ = 0;
+
+	bool enter(const unsigned min_complete) {
+		__atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+		for(;;) {
+			const auto pending = sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+
+			if(pending == 0 && min_complete == 0) {
+				return true;
+			}
+
+			if(::syscall(__NR_io_uring_enter, fd_, pending, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0) >= 0) {
+				return true;
+			}
+
+			if(errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+				return false;
+			}
+		}
+	}
+
+	void * map(const size_t size, const off_t offset) const {
+		void * const ring = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+		return ring == MAP_FAILED ? nullptr : ring;
+	}
+};
+
+struct Arena {
+	explicit Arena(const size_t size) : size(size) {
+		void * const memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		data = memory == MAP_FAILED ? nullptr : static_cast<char *>(memory);
+	}
+
+	~Arena() {
+		if(data) ::munmap(data, size);
+	}
+
+	char * data = nullptr;
+	size_t size = 0;
+};
+
+// nullopt if io_uring cannot be used at all, the caller falls back to threads
+std::optional<bool> read_with_io_uring(const std::vector<std::string> & paths, const File_consumer & consumer, const unsigned queue_depth) {
+
+	struct Slot {
+		size_t path = 0;
+		Open_file file;
+		size_t done = 0;
+		char * data = nullptr;
+		bool fixed = false;
+		std::string heap; // for files that do not fit the slot
+	};
+
+	const auto slot_count = std::min<size_t>(queue_depth, std::max<size_t>(1, paths.size()));
+
+	// declared before the ring so they outlive it: a read still in flight when the ring goes away never lands in freed memory
+	Arena arena(slot_count * slot_size);
+	std::vector<Slot> slots(slot_count);
+	Ring ring;
+
+	// READ_FIXED dates back to the first io_uring kernels, but plain READ (large files, unregistered buffers) does not
+	if(!arena.data || !ring.setup(static_cast<unsigned>(slot_count)) || !ring.supports(IORING_OP_READ)) {
+		return std::nullopt;
+	}
+
+	std::vector<iovec> buffers(slot_count);
+
+	for(size_t i = 0; i < slot_count; ++i) {
+		buffers[i] = {arena.data + i * slot_size, slot_size};
+	}
+
+	// plain reads into the same arena still work if pinning the buffers is not allowed
+	const bool registered = ring.register_buffers(buffers.data(), static_cast<unsigned>(slot_count));
+
+	size_t next_path = 0;
+	bool ok = true;
+
+	const auto queue_read = [&](const size_t id) {
+		auto & slot = slots[id];
+		auto & sqe = ring.next_sqe();
+
+		sqe.opcode = slot.fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+		sqe.fd = slot.file.fd;
+		sqe.addr = reinterpret_cast<uint64_t>(slot.data + slot.done);
+		sqe.len = static_cast<unsigned>(std::min<size_t>(slot.file.size - slot.done, INT_MAX));
+		sqe.off = slot.done;
+		sqe.buf_index = slot.fixed ? static_cast<uint16_t>(id) : 0;
+		sqe.user_data = id;
+	};
+
+	// false once there is nothing left to read into this slot
+	const auto start_next = [&](const size_t id) {
+		auto & slot = slots[id];
+
+		while(next_path < paths.size()) {
+			slot.path = next_path++;
+
+			if(!open_file(paths[slot.path], slot.file)) {
+				ok = false;
+				continue;
+			}
+
+			if(slot.file.size == 0) {
+				::close(slot.file.fd);
+				slot.file.fd = -1;
+				consumer(paths[slot.path], {});
+				continue;
+			}
+
+			slot.done = 0;
+			slot.fixed = registered && slot.file.size <= slot_size;
+
+			if(slot.file.size <= slot_size) {
+				slot.data = arena.data + id * slot_size;
+			} else {
+				slot.heap.resize(slot.file.size);
+				slot.data = slot.heap.data();
+			}
+
+			queue_read(id);
+			return true;
+		}
+
+		return false;
+	};
+
+	const auto fail = [&] {
+		std::cerr << "Error: io_uring_enter failed: " << std::strerror(errno) << "\n";
+
+		for(auto & slot : slots) {
+
+			if(slot.file.fd >= 0) {
+				::close(slot.file.fd);
+			}
+		}
+
+		return false;
+	};
+
+	size_t in_flight = 0;
+
+	while(in_flight < slot_count && start_next(in_flight)) {
+		++in_flight;
+	}
+
+	std::vector<size_t> finished;
+
+	while(in_flight > 0) {
+
+		if(!ring.submit_and_wait()) {
+			return fail();
+		}
+
+		io_uring_cqe cqe{};
+		finished.clear();
+
+		while(ring.pop_completion(cqe)) {
+			const auto id = static_cast<size_t>(cqe.user_data);
+			auto & slot = slots[id];
+
+			if(cqe.res == -EAGAIN || cqe.res == -EINTR) {
+				queue_read(id);
+				continue;
+			}
+
+			if(cqe.res > 0 && slot.done + static_cast<size_t>(cqe.res) < slot.file.size) {
+				// short read, the rest follows
+				slot.done += static_cast<size_t>(cqe.res);
+				queue_read(id);
+				continue;
+			}
+
+			::close(slot.file.fd);
+			slot.file.fd = -1;
+
+			if(cqe.res >= 0) {
+				// a read of 0 means the file shrank since fstat
+				slot.done += static_cast<size_t>(cqe.res);
+				finished.push_back(id);
+				continue;
+			}
+
+			std::cerr << "Error: Could not read file " << paths[slot.path] << ": " << std::strerror(-cqe.res) << "\n";
+			ok = false;
+			std::string().swap(slot.heap);
+
+			if(!start_next(id)) {
+				--in_flight;
+			}
+		}
+
+		for(const auto id : finished) {
+			auto & slot = slots[id];
+
+			// get every queued read (retries, and the refill of the slot consumed last) to the kernel before parsing, so it runs under the consumer
+			if(!ring.submit()) {
+				return fail();
+			}
+
+			consumer(paths[slot.path], std::string_view(slot.data, slot.done));
+			std::string().swap(slot.heap);
+
+			if(!start_next(id)) {
+				--in_flight;
+			}
+		}
+	}
+
+	return ok;
+}
+
+#endif
+
+bool read_file(const std::string & path, std::string & contents) {
+	Open_file file;
+
+	if(!open_file(path, file)) {
+		return false;
+	}
+
+	contents.resize(file.size);
+	size_t done = 0;
+
+	while(done < file.size) {
+		const auto result = ::pread(file.fd, contents.data() + done, file.size - done, static_cast<off_t>(done));
+
+		if(result < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if(result < 0) {
+			std::cerr << "Error: Could not read file " << path << ": " << std::strerror(errno) << "\n";
+			::close(file.fd);
+			return false;
+		}
+
+		if(result == 0) {
+			break;
+		}
+
+		done += static_cast<size_t>(result);
+	}
+
+	contents.resize(done);
+	::close(file.fd);
+	return true;
+}
+
+bool read_with_threads(const std::vector<std::string> & paths, const File_consumer & consumer, const unsigned queue_depth) {
+
+	struct Completed {
+		size_t path = 0;
+		bool ok = false;
+		std::string contents;
+	};
+
+	std::mutex mutex;
+	std::condition_variable ready_changed;
+	std::condition_variable slot_freed;
+	std::deque<Completed> ready;
+	size_t buffered = 0; // files read or being read but not consumed yet
+	size_t next_path = 0;
+
+	const auto worker = [&] {
+
+		for(;;) {
+			size_t path = 0;
+
+			{
+				std::unique_lock lock(mutex);
+				slot_freed.wait(lock, [&] { return buffered < queue_depth || next_path == paths.size(); });
+
+				if(next_path == paths.size()) {
+					return;
+				}
+
+				path = next_path++;
+				++buffered;
+			}
+
+			Completed completed{path, false, {}};
+			completed.ok = read_file(paths[path], completed.contents);
+
+			{
+				std::lock_guard lock(mutex);
+				ready.push_back(std::move(completed));
+			}
+
+			ready_changed.notify_one();
+		}
+	};
+
+	const auto thread_count = std::min<size_t>({queue_depth, paths.size(), std::max(1u, std::thread::hardware_concurrency())});
+	std::vector<std::thread> workers;
+
+	for(size_t i = 0; i < thread_count; ++i) {
+		workers.emplace_back(worker);
+	}
+
+	bool ok = true;
+
+	for(size_t consumed = 0; consumed < paths.size(); ++consumed) {
+		Completed completed;
+
+		{
+			std::unique_lock lock(mutex);
+			ready_changed.wait(lock, [&] { return !ready.empty(); });
+			completed = std::move(ready.front());
+			ready.pop_front();
+		}
+
+		if(completed.ok) {
+			consumer(paths[completed.path], completed.contents);
+		} else {
+			ok = false;
+		}
+
+		{
+			std::lock_guard lock(mutex);
+			--buffered;
+		}
+
+		slot_freed.notify_one();
+	}
+
+	slot_freed.notify_all();
+
+	for(auto & thread : workers) {
+		thread.join();
+	}
+
+	return ok;
+}
+
+} // namespace
+
+bool Batch_reader::read(const std::vector<std::string> & paths, const File_consumer & consumer) {
+
+#ifdef HAVE_IO_URING
+	if(const auto result = read_with_io_uring(paths, consumer, queue_depth_)) {
+		backend_ = "io_uring";
+		return *result;
+	}
+#endif
+
+	backend_ = "pread thread pool";
+	return read_with_threads(paths, consumer, queue_depth_);
+}
+
+bool read_sequentially(const std::vector<std::string> & paths, const File_consumer & consumer) {
+	bool ok = true;
+
+	for(const auto & path : paths) {
+		std::ifstream source_code(path);
+
+		if(!source_code) {
+			std::cerr << "Error: Could not open file " << path << "\n";
+			ok = false;
+			continue;
+		}
+
+		std::stringstream iss;
+		iss << source_code.rdbuf();
+		consumer(path, iss.str());
+	}
+
+	return ok;
+}
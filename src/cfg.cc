@@ -0,0 +1,548 @@
+#include "cfg.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+class Cfg_builder {
+public:
+	explicit Cfg_builder(const std::vector<Token> & tokens) : tokens_(tokens) {}
+
+	bool at_end() const { return peek().type == TokenType::END_OF_FILE; }
+
+	// Type identifier < ArgList > CompoundStmt
+	std::optional<Control_flow_graph> function() {
+		cfg_ = Control_flow_graph{};
+		variables_.clear();
+		new_block(); // entry
+		new_block(); // exit
+		current_ = Control_flow_graph::entry;
+
+		if(!expect_type() || !expect(TokenType::IDENTIFIER)) {
+			return std::nullopt;
+		}
+
+		cfg_.name = tokens_[position_ - 1].value;
+
+		if(!expect_value("<")) {
+			return std::nullopt;
+		}
+
+		do {
+			if(!expect_type() || !expect(TokenType::IDENTIFIER)) {
+				return std::nullopt;
+			}
+
+			emit(Cfg_instruction::Kind::DECLARE, tokens_[position_ - 1]);
+		} while(accept_value(","));
+
+		if(!expect_value(">") || peek().type != TokenType::LBRACE || !statement()) {
+			return std::nullopt;
+		}
+
+		edge(current_, Control_flow_graph::exit);
+		merge_chains();
+		return std::move(cfg_);
+	}
+
+private:
+	const std::vector<Token> & tokens_;
+	size_t position_ = 0;
+
+	Control_flow_graph cfg_;
+	std::unordered_map<std::string, uint32_t> variables_;
+	uint32_t current_ = 0;
+
+	const Token & peek() const { return tokens_[position_]; }
+
+	const Token & next() {
+		// never step past END_OF_FILE
+		return position_ + 1 < tokens_.size() ? tokens_[position_++] : tokens_.back();
+	}
+
+	bool error(const std::string & expected) const {
+		std::cerr << "[Error] Expected " << expected << " but got " << peek().value << "\n";
+		return false;
+	}
+
+	bool expect(const TokenType type) {
+
+		if(peek().type != type) {
+			std::ostringstream expected;
+			expected << type;
+			return error(expected.str());
+		}
+
+		next();
+		return true;
+	}
+
+	bool expect_type() {
+
+		if(peek().type != TokenType::TYPE) {
+			return error("int or float");
+		}
+
+		next();
+		return true;
+	}
+
+	bool expect_value(const std::string & value) {
+		return accept_value(value) || error(value);
+	}
+
+	bool accept_value(const std::string & value) {
+
+		if(peek().value != value || peek().type == TokenType::IDENTIFIER) {
+			return false;
+		}
+
+		next();
+		return true;
+	}
+
+	uint32_t new_block() {
+		cfg_.blocks.emplace_back();
+		return static_cast<uint32_t>(cfg_.blocks.size() - 1);
+	}
+
+	void edge(const uint32_t from, const uint32_t to) {
+		cfg_.blocks[from].successors.push_back(to);
+		cfg_.blocks[to].predecessors.push_back(from);
+	}
+
+	// starts a new block as the only successor of the current one
+	uint32_t follow() {
+		const auto block = new_block();
+		edge(current_, block);
+		current_ = block;
+		return block;
+	}
+
+	void emit(const Cfg_instruction::Kind kind, const Token & identifier) {
+		const auto [it, inserted] = variables_.try_emplace(identifier.value, static_cast<uint32_t>(cfg_.variables.size()));
+
+		if(inserted) {
+			cfg_.variables.push_back(identifier.value);
+		}
+
+		cfg_.blocks[current_].instructions.push_back({kind, it->second, identifier.offset});
+	}
+
+	// folds every block whose only predecessor has it as the only successor into that predecessor, then renumbers; entry and exit keep their ids
+	void merge_chains() {
+		auto & blocks = cfg_.blocks;
+		std::vector<bool> merged(blocks.size());
+
+		for(uint32_t b = 0; b < blocks.size(); ++b) {
+
+			while(!merged[b] && blocks[b].successors.size() == 1) {
+				const auto next = blocks[b].successors.front();
+
+				if(next == b || next == Control_flow_graph::exit || blocks[next].predecessors.size() != 1) {
+					break;
+				}
+
+				auto & absorbed = blocks[next];
+				blocks[b].instructions.insert(blocks[b].instructions.end(), absorbed.instructions.begin(), absorbed.instructions.end());
+				blocks[b].successors = std::move(absorbed.successors);
+
+				for(const auto successor : blocks[b].successors) {
+					std::replace(blocks[successor].predecessors.begin(), blocks[successor].predecessors.end(), next, b);
+				}
+
+				absorbed = {};
+				merged[next] = true;
+			}
+		}
+
+		std::vector<uint32_t> id(blocks.size());
+		uint32_t kept = 0;
+
+		for(uint32_t b = 0; b < blocks.size(); ++b) {
+
+			if(merged[b]) {
+				continue;
+			}
+
+			if(kept != b) {
+				blocks[kept] = std::move(blocks[b]);
+			}
+
+			id[b] = kept++;
+		}
+
+		blocks.resize(kept);
+
+		for(auto & block : blocks) {
+
+			for(auto & successor : block.successors) {
+				successor = id[successor];
+			}
+
+			for(auto & predecessor : block.predecessors) {
+				predecessor = id[predecessor];
+			}
+		}
+	}
+
+	// a construct whose statement has been opened but not finished yet
+	struct Pending {
+		enum class Kind {
+			COMPOUND, // { StmtList }, waiting for '}'
+			FOR_BODY,
+			LOOP_BODY,
+			IF_THEN,
+			IF_ELSE
+		};
+
+		Kind kind{};
+		uint32_t condition = 0;
+		uint32_t step = 0;
+		uint32_t join = 0;
+		uint32_t then_end = 0;
+	};
+
+	// iterative over an explicit stack of pending constructs, nesting depth is bounded by memory rather than the C stack
+	bool statement() {
+		std::vector<Pending> pending;
+		bool want_statement = true;
+
+		for(;;) {
+
+			if(want_statement) {
+				want_statement = false;
+				const auto & token = peek();
+
+				switch(token.type) {
+					case TokenType::ELSE: return error("statement");
+
+					case TokenType::LBRACE: {
+						next();
+						pending.push_back({Pending::Kind::COMPOUND});
+						break;
+					}
+
+					case TokenType::FOR: {
+
+						if(!for_header(pending)) {
+							return false;
+						}
+
+						want_statement = true;
+						continue;
+					}
+
+					case TokenType::IF: {
+
+						if(!if_header(pending)) {
+							return false;
+						}
+
+						want_statement = true;
+						continue;
+					}
+
+					case TokenType::TYPE: {
+
+						if(!declaration()) {
+							return false;
+						}
+
+						break;
+					}
+
+					case TokenType::SEMICOLON: {
+						next();
+						break;
+					}
+
+					case TokenType::IDENTIFIER: {
+
+						if(token.value == "loop") {
+
+							if(!loop_header(pending)) {
+								return false;
+							}
+
+							want_statement = true;
+							continue;
+						}
+					} [[fallthrough]];
+
+					default : {
+
+						if(!expression(";", true) || !expect_value(";")) {
+							return false;
+						}
+					}
+				}
+			}
+
+			// a statement is complete or a compound statement just opened: resume the innermost construct
+			if(pending.empty()) {
+				return true;
+			}
+
+			auto & top = pending.back();
+
+			switch(top.kind) {
+
+				case Pending::Kind::COMPOUND: {
+
+					if(peek().type == TokenType::RBRACE) {
+						next();
+						pending.pop_back();
+					} else if(at_end()) {
+						return error("}");
+					} else {
+						want_statement = true;
+					}
+
+					break;
+				}
+
+				case Pending::Kind::FOR_BODY: {
+					edge(current_, top.step);
+					edge(top.step, top.condition);
+
+					current_ = top.condition;
+					pending.pop_back();
+					follow();
+					break;
+				}
+
+				case Pending::Kind::LOOP_BODY: {
+					edge(current_, top.condition);
+
+					current_ = top.condition;
+					pending.pop_back();
+					follow();
+					break;
+				}
+
+				case Pending::Kind::IF_THEN: {
+					const auto then_end = current_;
+					const auto join = new_block();
+
+					if(peek().type == TokenType::ELSE) {
+						next();
+						current_ = top.condition;
+						follow();
+
+						top = {Pending::Kind::IF_ELSE, top.condition, 0, join, then_end};
+						want_statement = true;
+						break;
+					}
+
+					edge(top.condition, join);
+					edge(then_end, join);
+					current_ = join;
+					pending.pop_back();
+					break;
+				}
+
+				case Pending::Kind::IF_ELSE: {
+					edge(current_, top.join);
+					edge(top.then_end, top.join);
+					current_ = top.join;
+					pending.pop_back();
+					break;
+				}
+			}
+		}
+	}
+
+	// Type IdentList ;
+	bool declaration() {
+		next();
+
+		do {
+			if(peek().type != TokenType::IDENTIFIER) {
+				return error("identifier");
+			}
+
+			emit(Cfg_instruction::Kind::DECLARE, next());
+		} while(accept_value(","));
+
+		return expect_value(";");
+	}
+
+	// for < Expr ; OptExpr ; OptExpr >, the body Stmt follows
+	bool for_header(std::vector<Pending> & pending) {
+		next();
+
+		if(!expect_value("<") || !expression(";", true) || !expect_value(";")) {
+			return false;
+		}
+
+		const auto condition = follow();
+
+		if(!expression(";", false) || !expect_value(";")) {
+			return false;
+		}
+
+		// the step is read before the body but runs after it
+		const auto step = new_block();
+		current_ = step;
+
+		if(!expression(">", false) || !expect_value(">")) {
+			return false;
+		}
+
+		current_ = condition;
+		follow();
+
+		pending.push_back({Pending::Kind::FOR_BODY, condition, step});
+		return true;
+	}
+
+	// loop < Expr >, the body Stmt follows
+	bool loop_header(std::vector<Pending> & pending) {
+		next();
+		const auto condition = follow();
+
+		if(!expect_value("<") || !expression(">", true) || !expect_value(">")) {
+			return false;
+		}
+
+		follow();
+
+		pending.push_back({Pending::Kind::LOOP_BODY, condition});
+		return true;
+	}
+
+	// agar < Expr >, the Stmt and MagarPart follow
+	bool if_header(std::vector<Pending> & pending) {
+		next();
+
+		if(!expect_value("<") || !expression(">", true) || !expect_value(">")) {
+			return false;
+		}
+
+		const auto condition = current_;
+		follow();
+
+		pending.push_back({Pending::Kind::IF_THEN, condition});
+		return true;
+	}
+
+	// reads up to (not including) the terminator at group depth zero, recording uses
+	bool expression(const std::string & terminator, const bool required) {
+		const auto start = position_;
+		size_t depth = 0;
+		bool after_operand = false;
+
+		for(;;) {
+			const auto & token = peek();
+
+			if(depth == 0 && token.value == terminator && token.type != TokenType::IDENTIFIER) {
+				break;
+			}
+
+			switch(token.type) {
+				case TokenType::IDENTIFIER: {
+					emit(Cfg_instruction::Kind::USE, token);
+					after_operand = true;
+					break;
+				}
+
+				case TokenType::NUMBER: {
+					after_operand = true;
+					break;
+				}
+
+				case TokenType::LT: {
+					depth += !after_operand;
+					after_operand = false;
+					break;
+				}
+
+				case TokenType::PLUS:
+				case TokenType::MINUS:
+				case TokenType::MULTIPLY:
+				case TokenType::DIVIDE:
+				case TokenType::COMPARE: {
+					after_operand = false;
+					break;
+				}
+
+				// a lone '>' or '=' is scanned as INVALID
+				case TokenType::INVALID: {
+
+					if(token.value == ">" && depth > 0) {
+						--depth;
+						after_operand = true;
+						break;
+					}
+
+					if(token.value == ">" || token.value == "=") {
+						after_operand = false;
+						break;
+					}
+				} [[fallthrough]];
+
+				default : {
+					return error(terminator);
+				}
+			}
+
+			next();
+		}
+
+		return position_ != start || !required || error("expression");
+	}
+};
+
+} // namespace
+
+std::vector<uint32_t> Control_flow_graph::reverse_post_order() const {
+	std::vector<uint32_t> order;
+	order.reserve(blocks.size());
+
+	std::vector<bool> visited(blocks.size());
+	// explicit stack of (block, next successor), function bodies can be deeply nested
+	std::vector<std::pair<uint32_t, size_t>> stack{{entry, 0}};
+	visited[entry] = true;
+
+	while(!stack.empty()) {
+		auto & [block, successor] = stack.back();
+
+		if(successor < blocks[block].successors.size()) {
+			const auto next = blocks[block].successors[successor++];
+
+			if(!visited[next]) {
+				visited[next] = true;
+				stack.emplace_back(next, 0);
+			}
+
+			continue;
+		}
+
+		order.push_back(block);
+		stack.pop_back();
+	}
+
+	return {order.rbegin(), order.rend()};
+}
+
+std::optional<std::vector<Control_flow_graph>> build_cfgs(const std::vector<Token> & tokens) {
+	std::vector<Control_flow_graph> cfgs;
+	Cfg_builder builder(tokens);
+
+	while(!builder.at_end()) {
+		auto cfg = builder.function();
+
+		if(!cfg) {
+			return std::nullopt;
+		}
+
+		cfgs.push_back(std::move(*cfg));
+	}
+
+	return cfgs;
+}
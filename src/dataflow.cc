@@ -0,0 +1,236 @@
+#include "dataflow.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+
+constexpr auto unvisited = std::numeric_limits<uint32_t>::max();
+
+// an instruction of a variable, by block and the offset of its identifier
+struct Site {
+	uint32_t block = 0;
+	size_t offset = 0;
+};
+
+// what is known about one block for a batch of up to 64 variables, one bit each
+struct Block_bits {
+	uint64_t declares = 0;
+	uint64_t in_range = 0; // live at the start of the block, or a declaration bounding the range
+	uint64_t live = 0;
+	uint64_t undeclared = 0; // the undeclared state reaches the start of the block
+	uint64_t declared = 0; // some declaration does
+	uint64_t pending = 0; // bits not yet passed on to the neighbours
+};
+
+} // namespace
+
+std::vector<Lint_warning> lint(const Control_flow_graph & cfg) {
+	const auto block_count = cfg.blocks.size();
+	const auto variable_count = cfg.variables.size();
+	const auto order = cfg.reverse_post_order();
+
+	std::vector<bool> reachable(block_count);
+
+	for(const auto b : order) {
+		reachable[b] = true;
+	}
+
+	std::vector<Lint_warning> warnings;
+
+	std::vector<std::vector<uint32_t>> declaring(variable_count); // blocks declaring the variable, each once
+	std::vector<std::vector<Site>> exposed(variable_count); // reads before any declaration in their block
+	std::vector<std::vector<Site>> trailing(variable_count); // last declarations of a block with no read after them there, unused unless live at the block's end
+
+	// per variable, the block it was last seen declared or read in by the walks below
+	std::vector<uint32_t> declared_in(variable_count, unvisited);
+	std::vector<uint32_t> declared_after(variable_count, unvisited);
+	std::vector<uint32_t> read_after(variable_count, unvisited);
+
+	// everything that can be told from inside a single block
+	for(const auto b : order) {
+		const auto & instructions = cfg.blocks[b].instructions;
+
+		for(const auto & instruction : instructions) {
+			const auto variable = instruction.variable;
+
+			if(instruction.kind == Cfg_instruction::Kind::USE) {
+
+				if(declared_in[variable] != b) {
+					exposed[variable].push_back({b, instruction.offset});
+				}
+			} else if(declared_in[variable] != b) {
+				declared_in[variable] = b;
+				declaring[variable].push_back(b);
+			}
+		}
+
+		for(auto it = instructions.rbegin(); it != instructions.rend(); ++it) {
+			const auto variable = it->variable;
+
+			if(it->kind == Cfg_instruction::Kind::USE) {
+				read_after[variable] = b;
+				continue;
+			}
+
+			if(read_after[variable] == b) {
+				read_after[variable] = unvisited;
+			} else if(declared_after[variable] == b) {
+				warnings.push_back({Lint_warning::Kind::UNUSED, variable, it->offset});
+			} else {
+				trailing[variable].push_back({b, it->offset});
+			}
+
+			declared_after[variable] = b;
+		}
+	}
+
+	// variables are taken 64 at a time, each batch resets a block the first time it touches it
+	std::vector<Block_bits> bits(block_count);
+	std::vector<size_t> batch_of(block_count, std::numeric_limits<size_t>::max());
+	size_t batch = 0;
+
+	const auto at = [&](const uint32_t block) -> Block_bits & {
+
+		if(batch_of[block] != batch) {
+			batch_of[block] = batch;
+			bits[block] = {};
+		}
+
+		return bits[block];
+	};
+
+	std::vector<uint32_t> stack;
+
+	const auto queue = [&](const uint32_t block, const uint64_t variables) {
+		auto & state = at(block);
+
+		if(state.pending == 0) {
+			stack.push_back(block);
+		}
+
+		state.pending |= variables;
+	};
+
+	// the variables of reached that get into successor, only where they are live
+	const auto flow = [&](const uint32_t successor, const uint64_t variables, uint64_t Block_bits::* const reached) {
+		auto & state = at(successor);
+		const auto added = variables & state.live & ~(state.*reached);
+
+		if(added != 0) {
+			state.*reached |= added;
+			queue(successor, added);
+		}
+	};
+
+	// forwards through the live ranges from the queued blocks, a declaration ends the walk of its variable
+	const auto propagate = [&](uint64_t Block_bits::* const reached) {
+
+		while(!stack.empty()) {
+			const auto block = stack.back();
+			stack.pop_back();
+
+			auto & state = at(block);
+			const auto variables = std::exchange(state.pending, 0) & ~state.declares;
+
+			for(const auto successor : cfg.blocks[block].successors) {
+				flow(successor, variables, reached);
+			}
+		}
+	};
+
+	for(uint32_t first = 0; first < variable_count; first += 64, ++batch) {
+		const auto last = static_cast<uint32_t>(std::min<size_t>(first + 64, variable_count));
+		const auto bit = [first](const uint32_t variable) { return uint64_t{1} << (variable - first); };
+
+		for(auto variable = first; variable < last; ++variable) {
+
+			for(const auto block : declaring[variable]) {
+				at(block).declares |= bit(variable);
+			}
+
+			for(const auto & use : exposed[variable]) {
+				auto & state = at(use.block);
+
+				if(!(state.live & bit(variable))) {
+					state.live |= bit(variable);
+					state.in_range |= bit(variable);
+					queue(use.block, bit(variable));
+				}
+			}
+		}
+
+		// the live ranges, backwards from the exposed reads up to the declarations
+		while(!stack.empty()) {
+			const auto block = stack.back();
+			stack.pop_back();
+
+			const auto variables = std::exchange(at(block).pending, 0);
+
+			for(const auto predecessor : cfg.blocks[block].predecessors) {
+
+				if(!reachable[predecessor]) {
+					continue;
+				}
+
+				auto & state = at(predecessor);
+				const auto reached = variables & ~state.in_range;
+				state.in_range |= reached;
+
+				if(const auto live = reached & ~state.declares; live != 0) {
+					state.live |= live;
+					queue(predecessor, live);
+				}
+			}
+		}
+
+		// every variable starts out undeclared at entry
+		if(auto & entry = at(Control_flow_graph::entry); entry.live != 0) {
+			entry.undeclared = entry.live;
+			queue(Control_flow_graph::entry, entry.live);
+		}
+
+		propagate(&Block_bits::undeclared);
+
+		for(auto variable = first; variable < last; ++variable) {
+
+			for(const auto block : declaring[variable]) {
+
+				if(at(block).in_range & bit(variable)) {
+
+					for(const auto successor : cfg.blocks[block].successors) {
+						flow(successor, bit(variable), &Block_bits::declared);
+					}
+				}
+			}
+		}
+
+		propagate(&Block_bits::declared);
+
+		for(auto variable = first; variable < last; ++variable) {
+
+			for(const auto & use : exposed[variable]) {
+				const auto & state = at(use.block);
+
+				if(state.undeclared & bit(variable)) {
+					warnings.push_back({state.declared & bit(variable) ? Lint_warning::Kind::MAYBE_UNDECLARED : Lint_warning::Kind::UNDECLARED, variable, use.offset});
+				}
+			}
+
+			for(const auto & declaration : trailing[variable]) {
+				const auto & successors = cfg.blocks[declaration.block].successors;
+
+				if(std::none_of(successors.begin(), successors.end(), [&](const uint32_t successor) { return at(successor).live & bit(variable); })) {
+					warnings.push_back({Lint_warning::Kind::UNUSED, variable, declaration.offset});
+				}
+			}
+		}
+	}
+
+	std::stable_sort(warnings.begin(), warnings.end(), [](const Lint_warning & lhs, const Lint_warning & rhs) {
+		return lhs.offset < rhs.offset;
+	});
+
+	return warnings;
+}
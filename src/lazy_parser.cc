@@ -0,0 +1,150 @@
+#include "lazy_parser.h"
+#include "scanner.h"
+
+#include <iostream>
+#include <optional>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// reports only errors that stop the parse; an empty StmtList is reached through follow-set
+// recovery, so recovered warnings would show up for every well-formed body
+struct Failure_printer : Error_printer {
+
+	void on_no_production(const Non_terminal non_terminal, const Token & token, const bool recovered) {
+
+		if(!recovered) {
+			Error_printer::on_no_production(non_terminal, token, recovered);
+		}
+	}
+};
+
+// collects Type identifier < ArgList > and stops at the body
+struct Signature_collector : Failure_printer {
+	static constexpr bool stops_at_body = true;
+
+	std::vector<Token> tokens;
+	bool body_found = false;
+	size_t body_begin = 0;
+	std::optional<Token> missing_body; // where a '{' was due, when the CompoundStmt was only recovered
+
+	void on_token(Terminal, const Token & token) {
+		tokens.push_back(token);
+	}
+
+	void on_body(const Token & lbrace) {
+		body_found = true;
+		body_begin = lbrace.offset;
+	}
+
+	void on_no_production(const Non_terminal non_terminal, const Token & token, const bool recovered) {
+
+		if(non_terminal == COMPOUND_STMT && !missing_body) {
+			missing_body = token;
+		}
+
+		Failure_printer::on_no_production(non_terminal, token, recovered);
+	}
+};
+
+struct Body_collector : Failure_printer {
+	std::vector<Token> tokens;
+
+	void on_token(Terminal, const Token & token) {
+		tokens.push_back(token);
+	}
+};
+
+} // namespace
+
+size_t skip_braces(const std::string_view input, const size_t open) {
+	size_t depth = 0;
+	size_t i = open;
+
+#if defined(__SSE2__)
+	const auto lbrace = _mm_set1_epi8('{');
+	const auto rbrace = _mm_set1_epi8('}');
+
+	for(; i + 16 <= input.size(); i += 16) {
+		const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input.data() + i));
+		auto opens = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, lbrace)));
+		auto closes = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, rbrace)));
+
+		// walk the braces of this block in order, lowest bit first
+		for(auto braces = opens | closes; braces != 0; braces &= braces - 1) {
+			const auto bit = braces & -braces;
+
+			if(opens & bit) {
+				++depth;
+			} else if(--depth == 0) {
+				return i + static_cast<size_t>(__builtin_ctz(bit)) + 1;
+			}
+		}
+	}
+#endif
+
+	for(; i < input.size(); ++i) {
+
+		if(input[i] == '{') {
+			++depth;
+		} else if(input[i] == '}' && --depth == 0) {
+			return i + 1;
+		}
+	}
+
+	return std::string_view::npos;
+}
+
+const Parsed_body & Lazy_body::get() {
+
+	std::call_once(once_, [this] {
+		// cut the view at the closing brace so the scanner reports END_OF_FILE right after it
+		Scanner scanner(range_.input.substr(0, range_.end), range_.begin);
+		Body_collector collector;
+		collector.lines = &lines_;
+
+		result_.valid = parser_.parse(scanner, collector, COMPOUND_STMT);
+		result_.tokens = std::move(collector.tokens);
+		parsed_ = true;
+	});
+
+	return result_;
+}
+
+Lazy_program::Lazy_program(std::string_view input) : input_(input.substr(0, input.find('\0'))), lines_(input_) {
+	Scanner scanner(input_);
+
+	for(;;) {
+
+		if(auto lookahead = scanner; lookahead.nextToken().type == TokenType::END_OF_FILE) {
+			valid_ = true;
+			return;
+		}
+
+		Signature_collector collector;
+		collector.lines = &lines_;
+
+		if(!parser_.parse(scanner, collector)) {
+			return;
+		}
+
+		// the parse recovers from a missing body through the follow set, which is only a warning to it
+		if(!collector.body_found) {
+			collector.on_mismatch(T_LBRACE, collector.missing_body ? *collector.missing_body : scanner.nextToken());
+			return;
+		}
+
+		const auto body_end = skip_braces(input_, collector.body_begin);
+
+		if(body_end == std::string_view::npos) {
+			std::cerr << "[Error] " << lines_.position(collector.body_begin) << ": Unterminated body of function '" << collector.tokens[1].value << "'\n";
+			return;
+		}
+
+		functions_.emplace_back(std::move(collector.tokens), Lazy_body::Range{input_, collector.body_begin, body_end}, parser_, lines_);
+		scanner = Scanner(input_, body_end);
+	}
+}
@@ -0,0 +1,43 @@
+#include "line_index.h"
+
+#include <algorithm>
+#include <ostream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+std::ostream & operator << (std::ostream & os, const Source_position & position) {
+	return os << position.line << ':' << position.column;
+}
+
+Source_position Line_index::position(const size_t offset) const {
+
+	std::call_once(built_, [this] {
+		line_starts_.push_back(0);
+		size_t i = 0;
+
+#if defined(__SSE2__)
+		const auto newline = _mm_set1_epi8('\n');
+
+		for(; i + 16 <= input_.size(); i += 16) {
+			const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input_.data() + i));
+
+			for(auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline))); mask != 0; mask &= mask - 1) {
+				line_starts_.push_back(i + static_cast<size_t>(__builtin_ctz(mask)) + 1);
+			}
+		}
+#endif
+
+		for(; i < input_.size(); ++i) {
+
+			if(input_[i] == '\n') {
+				line_starts_.push_back(i + 1);
+			}
+		}
+	});
+
+	// the last line starting at or before offset
+	const auto line = std::upper_bound(line_starts_.begin(), line_starts_.end(), offset) - line_starts_.begin();
+	return {static_cast<size_t>(line), offset - line_starts_[line - 1] + 1};
+}
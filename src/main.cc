@@ -2,21 +2,111 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <string_view>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <charconv>
+#include <thread>
+#include <vector>
 
 #include "scanner.h"
 #include "parser.h"
+#include "parallel_lexer.h"
+#include "lazy_parser.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "batch_reader.h"
+#include "perf_counters.h"
+#include "token_pipeline.h"
 
-int main(int argc, char ** argv) {
+// parses every regular file under directory quietly and reports the read + parse throughput
+int parse_batch(const char * directory, const bool sequential) {
+	std::vector<std::string> paths;
+	std::error_code error;
+
+	// the range-for would step with the throwing operator++
+	for(std::filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+		// entries whose status cannot be read, like dangling links, are skipped
+		std::error_code status_error;
+
+		if(it->is_regular_file(status_error)) {
+			paths.push_back(it->path().string());
+		}
+	}
 
-	if(argc != 2) {
-		std::cerr << "Usage: " << argv[0] << " <filename>\n";
+	if(error) {
+		std::cerr << "Error: Could not read directory " << directory << "\n";
 		return 1;
 	}
 
-	std::ifstream source_code(argv[1]);
+	std::sort(paths.begin(), paths.end());
+
+	const Parser parser;
+	size_t bytes = 0;
+	size_t failed = 0;
+
+	const auto consume = [&](const std::string &, const std::string_view contents) {
+		Scanner scanner(contents);
+		Parse_handler quiet;
+		bytes += contents.size();
+		failed += !parser.parse(scanner, quiet);
+	};
+
+	Batch_reader reader;
+	const auto start = std::chrono::steady_clock::now();
+	const bool ok = sequential ? read_sequentially(paths, consume) : reader.read(paths, consume);
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	const auto mib = static_cast<double>(bytes) / (1 << 20);
+	std::cout << paths.size() << " files, " << mib << " MiB in " << elapsed.count() << " s (" << mib / elapsed.count() << " MiB/s) using "
+		<< (sequential ? "sequential ifstream reads" : reader.backend()) << ", " << failed << " failed to parse\n";
+
+	return ok ? 0 : 1;
+}
+
+int usage(const char * program) {
+	std::cerr << "Usage: " << program << " <filename> [lexer threads]\n";
+	std::cerr << "       " << program << " --pipeline <filename>\n";
+	std::cerr << "       " << program << " --signatures <filename>\n";
+	std::cerr << "       " << program << " --bodies <filename> [threads]\n";
+	std::cerr << "       " << program << " --lint <filename>\n";
+	std::cerr << "       " << program << " --batch <directory>\n";
+	std::cerr << "       " << program << " --batch-sequential <directory>\n";
+	std::cerr << "       " << program << " --perf <filename>\n";
+	return 1;
+}
+
+int main(int argc, char ** argv) {
+
+	const std::string_view mode = (argc == 3 || argc == 4) && argv[1][0] == '-' ? argv[1] : "";
+
+	if((mode.empty() && argc != 2 && argc != 3) || (!mode.empty() && argc == 4 && mode != "--bodies")
+		|| (!mode.empty() && mode != "--signatures" && mode != "--bodies" && mode != "--lint" && mode != "--batch" && mode != "--batch-sequential" && mode != "--perf" && mode != "--pipeline")) {
+		return usage(argv[0]);
+	}
+
+	// the optional thread count of the default mode and --bodies, 0 picks one per core
+	size_t threads = 0;
+
+	if((mode.empty() && argc == 3) || argc == 4) {
+		const std::string_view count = argv[argc - 1];
+		const auto [end, error] = std::from_chars(count.data(), count.data() + count.size(), threads);
+
+		if(error != std::errc{} || end != count.data() + count.size()) {
+			return usage(argv[0]);
+		}
+	}
+
+	if(mode == "--batch" || mode == "--batch-sequential") {
+		return parse_batch(argv[2], mode == "--batch-sequential");
+	}
+
+	const auto filename = mode.empty() ? argv[1] : argv[2];
+	std::ifstream source_code(filename);
 
 	if(!source_code) {
-		std::cerr << "Error: Could not open file " << argv[1] << "\n";
+		std::cerr << "Error: Could not open file " << filename << "\n";
 		return 1;
 	}
 
@@ -26,9 +116,132 @@ int main(int argc, char ** argv) {
 		return iss.str();
 	}();
 
-	Scanner scanner(input);
+	// only built if a diagnostic needs a line number
+	const Line_index lines(input);
+
+	if(mode == "--lint") {
+		const auto cfgs = build_cfgs(lex_parallel(input));
+
+		if(!cfgs) {
+			return 1;
+		}
+
+		for(const auto & cfg : *cfgs) {
+
+			for(const auto & warning : lint(cfg)) {
+				const auto & name = cfg.variables[warning.variable];
+				std::cout << "[Warning] " << lines.position(warning.offset) << ": in " << cfg.name << ", ";
+
+				switch(warning.kind) {
+					case Lint_warning::Kind::UNDECLARED: std::cout << "'" << name << "' is not declared\n"; break;
+					case Lint_warning::Kind::MAYBE_UNDECLARED: std::cout << "'" << name << "' may not be declared on every path\n"; break;
+					case Lint_warning::Kind::UNUSED: std::cout << "'" << name << "' is declared but never used\n"; break;
+				}
+			}
+		}
+
+		return 0;
+	}
+
+	if(mode == "--pipeline") {
+		Parser parser;
+		Info_printer printer;
+		printer.lines = &lines;
+
+		Token_pipeline tokens(input);
+		parser.parse(tokens, printer);
+		std::cout << "\nParsing sucessful!\n";
+		return 0;
+	}
+
+	if(mode == "--perf") {
+		Perf_counters counters;
+
+		if(!counters.available()) {
+			std::cerr << "[Warning] Hardware counters unavailable (" << counters.error() << "), reporting wall-clock time only\n";
+		}
+
+		std::vector<Token> tokens;
+		Scanner scanner(input);
+
+		counters.start();
+
+		do {
+			tokens.push_back(scanner.nextToken());
+		} while(tokens.back().type != TokenType::END_OF_FILE);
+
+		const auto lex = counters.stop();
+		const auto token_count = tokens.size();
+
+		const Parser parser;
+		Token_buffer buffer(std::move(tokens));
+		Parse_handler quiet;
+
+		counters.start();
+		const bool parsed = parser.parse(buffer, quiet);
+		const auto parse = counters.stop();
+
+		report(std::cout, "lex", lex, token_count);
+		report(std::cout, "parse", parse, token_count);
+		return parsed ? 0 : 1;
+	}
+
+	if(mode == "--signatures" || mode == "--bodies") {
+		Lazy_program program(input);
+		auto & functions = program.functions();
+
+		// every worker asks for every body, each starting at its own place, so first accesses to a body race on its once-guard
+		if(mode == "--bodies" && !functions.empty()) {
+			const size_t worker_count = threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+			std::vector<std::thread> workers;
+
+			for(size_t worker = 0; worker < worker_count; ++worker) {
+				workers.emplace_back([&functions, worker, worker_count] {
+					const auto first = worker * functions.size() / worker_count;
+
+					for(size_t i = 0; i < functions.size(); ++i) {
+						functions[(first + i) % functions.size()].body.get();
+					}
+				});
+			}
+
+			for(auto & worker : workers) {
+				worker.join();
+			}
+		}
+
+		bool ok = program.valid();
+
+		for(auto & function : functions) {
+
+			for(const auto & token : function.signature) {
+				std::cout << token.value << ' ';
+			}
+
+			if(!function.body.parsed()) {
+				std::cout << "{ " << function.body.end() - function.body.begin() << " bytes }\n";
+				continue;
+			}
+
+			const auto & body = function.body.get();
+			ok = ok && body.valid;
+			std::cout << "{ " << body.tokens.size() << " tokens" << (body.valid ? "" : ", invalid") << " }\n";
+		}
+
+		return ok ? 0 : 1;
+	}
+
 	Parser parser;
-	parser.parse(scanner);
+	Info_printer printer;
+	printer.lines = &lines;
+
+	if(argc == 3) {
+		Token_buffer tokens(lex_parallel(input, threads));
+		parser.parse(tokens, printer);
+	} else {
+		Scanner scanner(input);
+		parser.parse(scanner, printer);
+	}
 
 	std::cout << "\nParsing sucessful!\n";
 }
@@ -0,0 +1,146 @@
+#include "parallel_lexer.h"
+#include "scanner.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+// below this a chunk is not worth a thread
+constexpr size_t min_chunk_size = 1 << 16;
+
+// how far past a split point to look for whitespace before settling for a blind guess
+constexpr size_t max_boundary_search = 4096;
+
+struct Chunk {
+	size_t begin = 0; // where lexing starts
+	size_t end = 0; // tokens starting at or after this belong to the next chunk
+	size_t resume = 0; // scanner position after the last token of this chunk
+	std::vector<Token> tokens;
+};
+
+void lex_chunk(const std::string_view input, Chunk & chunk) {
+	Scanner scanner(input, chunk.begin, false);
+	chunk.resume = chunk.begin;
+
+	for(auto token = scanner.nextToken(); token.type != TokenType::END_OF_FILE && token.offset < chunk.end; token = scanner.nextToken()) {
+		chunk.tokens.push_back(std::move(token));
+		chunk.resume = scanner.position();
+	}
+}
+
+size_t find_boundary(const std::string_view input, const size_t split, const size_t limit) {
+	const auto search_end = std::min({limit, split + max_boundary_search, input.size()});
+
+	for(auto i = split; i < search_end; ++i) {
+
+		if(std::isspace(static_cast<unsigned char>(input[i]))) {
+			return i;
+		}
+	}
+
+	return split;
+}
+
+void append(std::vector<Token> & tokens, std::vector<Token>::iterator first, std::vector<Token>::iterator last) {
+	tokens.insert(tokens.end(), std::make_move_iterator(first), std::make_move_iterator(last));
+}
+
+} // namespace
+
+std::vector<Token> lex_parallel(std::string_view input, size_t thread_count) {
+	// the scanner treats a NUL byte as the end of input
+	if(const auto nul = input.find('\0'); nul != std::string_view::npos) {
+		input = input.substr(0, nul);
+	}
+
+	if(thread_count == 0) {
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	const auto chunk_count = std::max<size_t>(1, std::min(thread_count, input.size() / min_chunk_size));
+	std::vector<Chunk> chunks(chunk_count);
+
+	for(size_t i = 0; i < chunk_count; ++i) {
+		const auto split = input.size() * i / chunk_count;
+		const auto next_split = input.size() * (i + 1) / chunk_count;
+		chunks[i].begin = i == 0 ? 0 : std::max(chunks[i - 1].begin, find_boundary(input, split, next_split));
+	}
+
+	for(size_t i = 0; i < chunk_count; ++i) {
+		chunks[i].end = i + 1 < chunk_count ? chunks[i + 1].begin : input.size();
+	}
+
+	{
+		std::vector<std::thread> workers;
+		workers.reserve(chunk_count - 1);
+
+		for(size_t i = 1; i < chunk_count; ++i) {
+			workers.emplace_back(lex_chunk, input, std::ref(chunks[i]));
+		}
+
+		lex_chunk(input, chunks.front());
+
+		for(auto & worker : workers) {
+			worker.join();
+		}
+	}
+
+	std::vector<Token> tokens;
+	size_t total = 0;
+
+	for(const auto & chunk : chunks) {
+		total += chunk.tokens.size();
+	}
+
+	tokens.reserve(total + 1);
+	append(tokens, chunks.front().tokens.begin(), chunks.front().tokens.end());
+	auto resume = chunks.front().resume;
+
+	for(size_t i = 1; i < chunk_count; ++i) {
+		auto & chunk = chunks[i];
+
+		// the previous chunk ended before this one started, so only whitespace lies in between
+		if(resume <= chunk.begin) {
+			append(tokens, chunk.tokens.begin(), chunk.tokens.end());
+			resume = chunk.resume;
+			continue;
+		}
+
+		// a token straddled the seam: re-lex until a token start coincides with a speculative one
+		Scanner scanner(input, resume, false);
+		auto speculative = chunk.tokens.begin();
+
+		for(auto token = scanner.nextToken(); token.type != TokenType::END_OF_FILE && token.offset < chunk.end; token = scanner.nextToken()) {
+
+			while(speculative != chunk.tokens.end() && speculative->offset < token.offset) {
+				++speculative;
+			}
+
+			if(speculative != chunk.tokens.end() && speculative->offset == token.offset) {
+				append(tokens, speculative, chunk.tokens.end());
+				resume = chunk.resume;
+				break;
+			}
+
+			tokens.push_back(std::move(token));
+			resume = scanner.position();
+		}
+	}
+
+	// workers lex silently, report bad characters in input order as the sequential scanner would
+	for(const auto & token : tokens) {
+
+		if(token.type == TokenType::INVALID && token.value.empty()) {
+			std::cerr << "Unexpected character: " << input[token.offset] << "\n";
+		}
+	}
+
+	Token end_of_file(TokenType::END_OF_FILE);
+	end_of_file.offset = input.size();
+	tokens.push_back(std::move(end_of_file));
+
+	return tokens;
+}
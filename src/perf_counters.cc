@@ -0,0 +1,188 @@
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if defined(__linux__)
+
+struct Event_config {
+	uint32_t type;
+	uint64_t config;
+};
+
+constexpr uint64_t cache_read_miss(const uint64_t cache) {
+	return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+constexpr std::array<Event_config, Perf_counters::EVENT_COUNT> event_configs {{
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	{PERF_TYPE_HW_CACHE, cache_read_miss(PERF_COUNT_HW_CACHE_L1D)},
+	{PERF_TYPE_HW_CACHE, cache_read_miss(PERF_COUNT_HW_CACHE_LL)},
+}};
+
+// a leader of -1 opens the event as a group of its own, which reads the same way as a larger one
+int open_counter(const Event_config & event, const int leader) {
+	perf_event_attr attr{};
+	attr.size = sizeof(attr);
+	attr.type = event.type;
+	attr.config = event.config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+}
+
+#endif
+
+} // namespace
+
+Perf_counters::Perf_counters() {
+	fds_.fill(-1);
+
+#if defined(__linux__)
+	// cycles leads the group; an event it rejects, or every event without it, counts on its own
+	fds_[CYCLES] = open_counter(event_configs[CYCLES], -1);
+
+	for(size_t i = 0; i < EVENT_COUNT; ++i) {
+
+		if(i != CYCLES && fds_[CYCLES] >= 0) {
+			fds_[i] = open_counter(event_configs[i], fds_[CYCLES]);
+			grouped_[i] = fds_[i] >= 0;
+		}
+
+		if(i != CYCLES && fds_[i] < 0) {
+			fds_[i] = open_counter(event_configs[i], -1);
+		}
+
+		if(fds_[i] < 0 && error_.empty()) {
+			error_ = std::string(name(static_cast<Event>(i))) + ": " + std::strerror(errno);
+		}
+	}
+#else
+	error_ = "perf_event_open is Linux only";
+#endif
+}
+
+Perf_counters::~Perf_counters() {
+
+#if defined(__linux__)
+	for(const auto fd : fds_) {
+
+		if(fd >= 0) {
+			::close(fd);
+		}
+	}
+#endif
+}
+
+bool Perf_counters::available() const {
+
+	for(const auto fd : fds_) {
+
+		if(fd >= 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Perf_counters::start() {
+
+#if defined(__linux__)
+	// members follow their leader
+	for(size_t i = 0; i < EVENT_COUNT; ++i) {
+
+		if(fds_[i] >= 0 && !grouped_[i]) {
+			::ioctl(fds_[i], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+			::ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		}
+	}
+#endif
+
+	start_ = std::chrono::steady_clock::now();
+}
+
+Perf_counters::Sample Perf_counters::stop() {
+	Sample sample;
+	sample.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+
+#if defined(__linux__)
+	for(size_t i = 0; i < EVENT_COUNT; ++i) {
+
+		if(fds_[i] < 0 || grouped_[i]) {
+			continue;
+		}
+
+		::ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+		// event count, time enabled, time running, then a value per event: the leader, then its members in the order they were attached
+		uint64_t counts[3 + EVENT_COUNT]{};
+
+		if(::read(fds_[i], counts, sizeof(counts)) < static_cast<ssize_t>(4 * sizeof(uint64_t)) || counts[2] == 0) {
+			continue;
+		}
+
+		// every event of a group ran for the same time, so they all scale alike
+		const auto scale = static_cast<double>(counts[1]) / static_cast<double>(counts[2]);
+		size_t value = 3;
+
+		for(size_t event = i; event < EVENT_COUNT && value < 3 + counts[0]; ++event) {
+
+			if(event == i || (i == CYCLES && grouped_[event])) {
+				sample.values[event] = static_cast<double>(counts[value++]) * scale;
+				sample.valid[event] = true;
+			}
+		}
+	}
+#endif
+
+	return sample;
+}
+
+const char * Perf_counters::name(const Event event) {
+
+	switch(event) {
+		case CYCLES: return "cycles";
+		case INSTRUCTIONS: return "instructions";
+		case BRANCH_MISSES: return "branch-misses";
+		case L1D_MISSES: return "L1d-misses";
+		case LLC_MISSES: return "LLC-misses";
+
+		default : {
+			return "unknown";
+		}
+	}
+}
+
+void report(std::ostream & os, const std::string_view phase, const Perf_counters::Sample & sample, const size_t tokens) {
+	os << "[PERF] " << phase << ": " << sample.seconds * 1e3 << " ms, " << tokens << " tokens";
+
+	if(sample.valid[Perf_counters::CYCLES] && sample.valid[Perf_counters::INSTRUCTIONS] && sample.values[Perf_counters::CYCLES] > 0) {
+		os << ", IPC " << sample.values[Perf_counters::INSTRUCTIONS] / sample.values[Perf_counters::CYCLES];
+	}
+
+	for(const auto event : {Perf_counters::CYCLES, Perf_counters::BRANCH_MISSES, Perf_counters::L1D_MISSES, Perf_counters::LLC_MISSES}) {
+
+		if(sample.valid[event] && tokens > 0) {
+			os << ", " << sample.values[event] / static_cast<double>(tokens) << ' ' << Perf_counters::name(event) << "/token";
+		}
+	}
+
+	os << '\n';
+}
@@ -17,6 +17,14 @@ void Scanner::skip_whitespace() {
 Token Scanner::nextToken() {
 	skip_whitespace();
 
+	const auto offset = position_;
+	auto token = scan_token();
+	token.offset = offset;
+	return token;
+}
+
+Token Scanner::scan_token() {
+
 	if(std::isalpha(current_char_)) {
 		return identifier_or_keyword();
 	}
@@ -56,7 +64,10 @@ Token Scanner::nextToken() {
 	case '\0':
 		return Token(TokenType::END_OF_FILE);
 	default:
-		std::cerr << "Unexpected character: " << current_char_ << "\n";
+		if(report_errors_) {
+			std::cerr << "Unexpected character: " << current_char_ << "\n";
+		}
+
 		advance();
 		return Token(TokenType::INVALID);
 	}
@@ -70,8 +81,9 @@ Token Scanner::identifier_or_keyword() {
 		advance();
 	}
 
-	if(keywords.find(result) != keywords.end()) {
-		return Token(keywords[result], result);
+	// lookup through find() only, scanners may run concurrently on the shared table
+	if(const auto it = keywords.find(result); it != keywords.end()) {
+		return Token(it->second, result);
 	}
 
 	return Token(TokenType::IDENTIFIER, result);
@@ -0,0 +1,81 @@
+#include "token_pipeline.h"
+#include "scanner.h"
+
+namespace {
+
+// spin briefly, then give the core away while the other side catches up
+void back_off(unsigned & spins) {
+
+	if(++spins > 64) {
+		std::this_thread::yield();
+	}
+}
+
+} // namespace
+
+Token_pipeline::Token_pipeline(std::string_view input, const size_t batch_size, const size_t batch_count)
+	: ring_(batch_count == 0 ? 1 : batch_count), batch_size_(batch_size == 0 ? 1 : batch_size), producer_(&Token_pipeline::produce, this, input) {}
+
+Token_pipeline::~Token_pipeline() {
+	stopping_.store(true, std::memory_order_relaxed);
+	producer_.join();
+}
+
+void Token_pipeline::produce(const std::string_view input) {
+	Scanner scanner(input);
+
+	for(;;) {
+		std::vector<Token> * batch = nullptr;
+
+		for(unsigned spins = 0; !(batch = ring_.claim()); back_off(spins)) {
+
+			if(stopping_.load(std::memory_order_relaxed)) {
+				return;
+			}
+		}
+
+		batch->clear();
+		batch->reserve(batch_size_);
+
+		do {
+			batch->push_back(scanner.nextToken());
+		} while(batch->size() < batch_size_ && batch->back().type != TokenType::END_OF_FILE);
+
+		const bool done = batch->back().type == TokenType::END_OF_FILE;
+		ring_.publish();
+
+		if(done) {
+			return;
+		}
+	}
+}
+
+Token Token_pipeline::nextToken() {
+
+	for(;;) {
+
+		if(finished_) {
+			return end_of_file_;
+		}
+
+		if(batch_ && position_ < batch_->size()) {
+			auto token = std::move((*batch_)[position_++]);
+
+			if(token.type == TokenType::END_OF_FILE) {
+				finished_ = true;
+				end_of_file_ = token;
+			}
+
+			return token;
+		}
+
+		if(batch_) {
+			ring_.pop();
+		}
+
+		// the producer only stops early when this pipeline is destroyed, so a batch always comes
+		for(unsigned spins = 0; !(batch_ = ring_.front()); back_off(spins)) {}
+
+		position_ = 0;
+	}
+}